@@ -0,0 +1,143 @@
+/* Price level only (L2) book for rebuilding venue books from market data */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "OrderBook.h"
+
+// no per order state is kept, a level is just a price and its total quantity
+struct AggregatedLevel {
+  price_t price{0};
+  quantity_t quantity{0};
+};
+
+// levels are kept in a flat vector sorted worst -> best so the best level is
+// at the back, most feed updates land near the top of book which makes the
+// insert/erase shift small and keeps each symbol in one contiguous allocation
+template <typename WorseThan>
+class AggregatedSide {
+ public:
+  void update(const price_t price, const quantity_t quantity) {
+    auto it = std::lower_bound(
+        levels.begin(), levels.end(), price,
+        [](const AggregatedLevel& level, const price_t p) {
+          return WorseThan{}(level.price, p);
+        });
+    bool const found = (it != levels.end() && it->price == price);
+
+    if (quantity == 0) {
+      if (found) levels.erase(it);
+    } else if (found) {
+      it->quantity = quantity;
+    } else {
+      levels.insert(it, AggregatedLevel{price, quantity});
+    }
+  }
+
+  void snapshot(const std::vector<LevelInfo>& snapshot_levels) {
+    levels.clear();
+    levels.reserve(snapshot_levels.size());
+    for (auto const& level : snapshot_levels) {
+      levels.push_back(AggregatedLevel{level.price, level.quantity});
+    }
+    // snapshots usually arrive best first, only sort when they do not, the
+    // sort is stable so repeated prices stay latest first after the reverse
+    std::reverse(levels.begin(), levels.end());
+    auto worse_than = [](const AggregatedLevel& lhs,
+                         const AggregatedLevel& rhs) {
+      return WorseThan{}(lhs.price, rhs.price);
+    };
+    if (!std::is_sorted(levels.begin(), levels.end(), worse_than)) {
+      std::stable_sort(levels.begin(), levels.end(), worse_than);
+    }
+
+    // a repeated price keeps its last quantity, as if applied as updates
+    auto same_price = [](const AggregatedLevel& lhs,
+                         const AggregatedLevel& rhs) {
+      return lhs.price == rhs.price;
+    };
+    levels.erase(std::unique(levels.begin(), levels.end(), same_price),
+                 levels.end());
+    std::erase_if(levels, [](const AggregatedLevel& level) {
+      return level.quantity == 0;
+    });
+  }
+
+  inline bool empty() const { return levels.empty(); }
+
+  inline size_t depth() const { return levels.size(); }
+
+  inline const AggregatedLevel& best() const { return levels.back(); }
+
+  std::vector<LevelInfo> get_levels(size_t max_depth) const {
+    std::vector<LevelInfo> result;
+    if (max_depth == 0) return result;
+    result.reserve(std::min(max_depth, depth()));
+
+    for (auto it = levels.rbegin(); it != levels.rend(); ++it) {
+      // order counts are not available from an aggregated feed
+      result.push_back(LevelInfo{it->price, it->quantity, 0});
+      if (--max_depth == 0) break;
+    }
+    return result;
+  }
+
+  std::vector<AggregatedLevel> levels;
+};
+
+class AggregatedOrderBook {
+ public:
+  // sets the total quantity at a price level, a quantity of 0 removes it
+  void update_level(const Side side, const price_t price,
+                    const quantity_t quantity) {
+    if (side == Side::Buy) {
+      bids.update(price, quantity);
+    } else {
+      asks.update(price, quantity);
+    }
+  }
+
+  // replaces the entire book, levels may be given in any order
+  void apply_snapshot(const std::vector<LevelInfo>& bid_levels,
+                      const std::vector<LevelInfo>& ask_levels) {
+    bids.snapshot(bid_levels);
+    asks.snapshot(ask_levels);
+  }
+
+  void clear() {
+    bids.levels.clear();
+    asks.levels.clear();
+  }
+
+  BookTop get_top() const {
+    BookTop top;
+    if (!bids.empty()) {
+      top.bid_price = bids.best().price;
+      top.bid_quantity = bids.best().quantity;
+    }
+    if (!asks.empty()) {
+      top.ask_price = asks.best().price;
+      top.ask_quantity = asks.best().quantity;
+    }
+    return top;
+  }
+
+  inline size_t bid_depth() const { return bids.depth(); }
+
+  inline size_t ask_depth() const { return asks.depth(); }
+
+  std::vector<LevelInfo> get_bids(size_t max_depth) const {
+    return bids.get_levels(max_depth);
+  }
+
+  std::vector<LevelInfo> get_asks(size_t max_depth) const {
+    return asks.get_levels(max_depth);
+  }
+
+  // best bid is the highest price, best ask is the lowest price
+  AggregatedSide<std::less<>> bids;
+  AggregatedSide<std::greater<>> asks;
+};
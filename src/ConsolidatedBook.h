@@ -0,0 +1,354 @@
+/* Consolidated best bid/offer and merged depth across many venue books */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "AggregatedOrderBook.h"
+
+// one merged price level, venues has bit v set if venue v quotes this price
+struct ConsolidatedLevel {
+  price_t price{0};
+  uint64_t quantity{0};
+  uint64_t venues{0};
+};
+
+// kernels over a row of int64 keys, one key per venue padded to a multiple
+// of 4 so the AVX2 path never needs a scalar tail
+namespace simd {
+
+inline int64_t max(const int64_t* keys, size_t count) {
+#if defined(__AVX2__)
+  __m256i best = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+  for (size_t i = 0; i < count; i += 4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    best = _mm256_blendv_epi8(best, v, _mm256_cmpgt_epi64(v, best));
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), best);
+  int64_t result = lanes[0];
+  for (size_t i = 1; i < 4; ++i) result = lanes[i] > result ? lanes[i] : result;
+  return result;
+#else
+  int64_t result = std::numeric_limits<int64_t>::min();
+  for (size_t i = 0; i < count; ++i) {
+    result = keys[i] > result ? keys[i] : result;
+  }
+  return result;
+#endif
+}
+
+// bit i is set when keys[i] == key
+inline uint64_t equal_mask(const int64_t* keys, size_t count, int64_t key) {
+  uint64_t mask = 0;
+#if defined(__AVX2__)
+  __m256i target = _mm256_set1_epi64x(key);
+  for (size_t i = 0; i < count; i += 4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    int bits = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(v, target)));
+    mask |= static_cast<uint64_t>(bits) << i;
+  }
+#else
+  for (size_t i = 0; i < count; ++i) {
+    mask |= static_cast<uint64_t>(keys[i] == key) << i;
+  }
+#endif
+  return mask;
+}
+
+// bit i is set when keys[i] > key
+inline uint64_t greater_mask(const int64_t* keys, size_t count, int64_t key) {
+  uint64_t mask = 0;
+#if defined(__AVX2__)
+  __m256i target = _mm256_set1_epi64x(key);
+  for (size_t i = 0; i < count; i += 4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    int bits = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpgt_epi64(v, target)));
+    mask |= static_cast<uint64_t>(bits) << i;
+  }
+#else
+  for (size_t i = 0; i < count; ++i) {
+    mask |= static_cast<uint64_t>(keys[i] > key) << i;
+  }
+#endif
+  return mask;
+}
+
+}  // namespace simd
+
+// top-N levels of every venue for one side in structure of arrays layout,
+// keys are prices for bids and negated prices for asks so that better is
+// always larger and both sides share the same kernels
+class ConsolidatedSide {
+ public:
+  static int64_t constexpr k_empty = std::numeric_limits<int64_t>::min();
+
+  ConsolidatedSide(size_t _num_venues, size_t _depth, bool _is_bid)
+      : num_venues(_num_venues),
+        stride((_num_venues + 3) & ~size_t{3}),
+        depth(_depth),
+        is_bid(_is_bid),
+        keys(stride * _depth, k_empty),
+        quantities(stride * _depth, 0),
+        head_keys(stride, k_empty),
+        head_quantities(stride, 0),
+        heads(stride, 0),
+        merged_keys((_depth + 3) & ~size_t{3}, k_empty),
+        old_keys(_depth, k_empty),
+        old_quantities(_depth, 0) {
+    merged.reserve(_depth + 1);
+  }
+
+  inline int64_t to_key(const price_t price) const {
+    return is_bid ? price : -price;
+  }
+
+  inline price_t to_price(const int64_t key) const {
+    return is_bid ? key : -key;
+  }
+
+  // writes the levels of one venue best first and folds the difference into
+  // the merged ladder, levels past the given ones are cleared
+  template <typename Levels>
+  void set_venue(const size_t venue, const Levels& levels) {
+    assert(venue < num_venues);
+    size_t level = 0;
+    for (; level < depth; ++level) {
+      old_keys[level] = keys[level * stride + venue];
+      old_quantities[level] = quantities[level * stride + venue];
+    }
+
+    level = 0;
+    for (auto const& [price, quantity] : levels) {
+      if (level == depth) break;
+      keys[level * stride + venue] = to_key(price);
+      quantities[level * stride + venue] = quantity;
+      ++level;
+    }
+    for (; level < depth; ++level) {
+      keys[level * stride + venue] = k_empty;
+      quantities[level * stride + venue] = 0;
+    }
+
+    update_merged(venue);
+  }
+
+  // incremental path, the venue's previous and current levels are diffed
+  // per price and only the differences touch the merged ladder, which is
+  // searched with the SIMD kernels. Falls back to a full merge only when a
+  // price leaves a full ladder since the level that replaces it is not
+  // tracked
+  void update_merged(const size_t venue) {
+    uint64_t const bit = uint64_t{1} << venue;
+    bool const was_full = (merged.size() == depth);
+
+    // prices the venue no longer quotes, both columns are sorted best first
+    bool emptied = false;
+    size_t next = 0;
+    for (size_t level = 0; level < depth; ++level) {
+      int64_t const key = old_keys[level];
+      if (key == k_empty) break;
+      while (next < depth && keys[next * stride + venue] > key) ++next;
+      if (next < depth && keys[next * stride + venue] == key) continue;
+
+      uint64_t const found =
+          simd::equal_mask(merged_keys.data(), merged_keys.size(), key);
+      // venue levels are sorted, the rest are below the ladder as well
+      if (found == 0) break;
+      auto& merged_level = merged[std::countr_zero(found)];
+      merged_level.quantity -= old_quantities[level];
+      merged_level.venues &= ~bit;
+      emptied |= (merged_level.venues == 0);
+    }
+    if (emptied) {
+      if (was_full) {
+        merge();
+        return;
+      }
+      std::erase_if(merged, [](const ConsolidatedLevel& merged_level) {
+        return merged_level.venues == 0;
+      });
+      sync_keys();
+    }
+
+    // prices the venue still quotes change quantity in place, new prices
+    // are inserted
+    size_t prev = 0;
+    for (size_t level = 0; level < depth; ++level) {
+      int64_t const key = keys[level * stride + venue];
+      if (key == k_empty) break;
+      while (prev < depth && old_keys[prev] > key) ++prev;
+      bool const quoted = (prev < depth && old_keys[prev] == key);
+      uint64_t const quantity = quantities[level * stride + venue];
+
+      uint64_t const found =
+          simd::equal_mask(merged_keys.data(), merged_keys.size(), key);
+      if (found != 0) {
+        auto& merged_level = merged[std::countr_zero(found)];
+        merged_level.quantity += quantity;
+        if (quoted) merged_level.quantity -= old_quantities[prev];
+        merged_level.venues |= bit;
+        continue;
+      }
+      // a price it already quoted was below the ladder and still is
+      if (quoted) continue;
+
+      size_t const pos = static_cast<size_t>(std::popcount(
+          simd::greater_mask(merged_keys.data(), merged_keys.size(), key)));
+      if (pos >= depth) break;
+      merged.insert(merged.begin() + pos,
+                    ConsolidatedLevel{to_price(key), quantity, bit});
+      if (merged.size() > depth) merged.pop_back();
+      sync_keys();
+    }
+  }
+
+  // k-way merge of the venue ladders, each step finds the best head key
+  // across all venues and every venue quoting it with one pass each
+  void merge() {
+    ++full_merges;
+    merged.clear();
+    for (size_t v = 0; v < num_venues; ++v) {
+      heads[v] = 0;
+      head_keys[v] = keys[v];
+      head_quantities[v] = quantities[v];
+    }
+
+    while (merged.size() < depth) {
+      int64_t const best = simd::max(head_keys.data(), stride);
+      if (best == k_empty) break;
+
+      ConsolidatedLevel merged_level;
+      merged_level.price = to_price(best);
+      merged_level.venues = simd::equal_mask(head_keys.data(), stride, best);
+      for (uint64_t mask = merged_level.venues; mask; mask &= mask - 1) {
+        size_t const v = static_cast<size_t>(std::countr_zero(mask));
+        merged_level.quantity += head_quantities[v];
+        size_t const next = ++heads[v];
+        head_keys[v] = next < depth ? keys[next * stride + v] : k_empty;
+        head_quantities[v] = next < depth ? quantities[next * stride + v] : 0;
+      }
+      merged.push_back(merged_level);
+    }
+    sync_keys();
+  }
+
+  void sync_keys() {
+    size_t i = 0;
+    for (; i < merged.size(); ++i) merged_keys[i] = to_key(merged[i].price);
+    for (; i < merged_keys.size(); ++i) merged_keys[i] = k_empty;
+  }
+
+  size_t num_venues;
+  size_t stride;  // num_venues rounded up to a multiple of 4
+  size_t depth;
+  bool is_bid;
+  // level l of venue v is at [l * stride + v]
+  std::vector<int64_t> keys;
+  std::vector<uint64_t> quantities;
+  // merge cursors, one per venue
+  std::vector<int64_t> head_keys;
+  std::vector<uint64_t> head_quantities;
+  std::vector<size_t> heads;
+  // merged ladder best first, with its keys mirrored for the SIMD searches
+  std::vector<ConsolidatedLevel> merged;
+  std::vector<int64_t> merged_keys;
+  // the updated venue's previous levels
+  std::vector<int64_t> old_keys;
+  std::vector<uint64_t> old_quantities;
+  uint64_t full_merges{0};  // times the incremental path had to fall back
+};
+
+class ConsolidatedBook {
+ public:
+  static size_t constexpr k_max_venues = 64U;  // one bit per venue
+  static size_t constexpr k_max_depth = 64U;   // one bit per merged level
+
+  ConsolidatedBook(size_t num_venues, size_t depth)
+      : bids(num_venues, depth, true), asks(num_venues, depth, false) {
+    assert(num_venues > 0 && num_venues <= k_max_venues);
+    assert(depth > 0 && depth <= k_max_depth);
+    level_buffer.reserve(depth);
+  }
+
+  // refreshes one venue's top levels straight from its book's level storage
+  void update_venue(const size_t venue, const OrderBook& book) {
+    level_buffer.clear();
+    for (auto const& [price, price_level] : book.bids) {
+      if (level_buffer.size() == bids.depth) break;
+      level_buffer.emplace_back(price, price_level.total_quantity);
+    }
+    bids.set_venue(venue, level_buffer);
+
+    level_buffer.clear();
+    for (auto const& [price, price_level] : book.asks) {
+      if (level_buffer.size() == asks.depth) break;
+      level_buffer.emplace_back(price, price_level.total_quantity);
+    }
+    asks.set_venue(venue, level_buffer);
+  }
+
+  void update_venue(const size_t venue, const AggregatedOrderBook& book) {
+    level_buffer.clear();
+    for (auto it = book.bids.levels.rbegin(); it != book.bids.levels.rend();
+         ++it) {
+      if (level_buffer.size() == bids.depth) break;
+      level_buffer.emplace_back(it->price, it->quantity);
+    }
+    bids.set_venue(venue, level_buffer);
+
+    level_buffer.clear();
+    for (auto it = book.asks.levels.rbegin(); it != book.asks.levels.rend();
+         ++it) {
+      if (level_buffer.size() == asks.depth) break;
+      level_buffer.emplace_back(it->price, it->quantity);
+    }
+    asks.set_venue(venue, level_buffer);
+  }
+
+  // summed quantities saturate at the quantity_t maximum, use get_bids()
+  // and get_asks() for the full 64 bit totals
+  BookTop get_top() const {
+    BookTop top;
+    if (!bids.merged.empty()) {
+      top.bid_price = bids.merged.front().price;
+      top.bid_quantity = saturate(bids.merged.front().quantity);
+    }
+    if (!asks.merged.empty()) {
+      top.ask_price = asks.merged.front().price;
+      top.ask_quantity = saturate(asks.merged.front().quantity);
+    }
+    return top;
+  }
+
+  static quantity_t saturate(const uint64_t quantity) {
+    return static_cast<quantity_t>(
+        std::min<uint64_t>(quantity, std::numeric_limits<quantity_t>::max()));
+  }
+
+  // merged ladders best first, at most depth levels each
+  inline const std::vector<ConsolidatedLevel>& get_bids() const {
+    return bids.merged;
+  }
+
+  inline const std::vector<ConsolidatedLevel>& get_asks() const {
+    return asks.merged;
+  }
+
+  ConsolidatedSide bids;
+  ConsolidatedSide asks;
+  // reused between updates so refreshing a venue never allocates
+  std::vector<std::pair<price_t, uint64_t>> level_buffer;
+};
@@ -0,0 +1,140 @@
+/* Cumulative quantity index over a fixed price band for fast sweep queries */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "Order.h"
+
+// result of walking one side of the book for a given quantity
+struct SweepCost {
+  bool filled{false};      // false if the side does not hold enough quantity
+  price_t worst_price{0};  // last price level touched when filled
+  int64_t notional{0};     // sum(price * quantity) over the filled quantity
+};
+
+// Fenwick trees of quantity and notional indexed by price tick, every update
+// and query is O(log(band width)) no matter how many levels are populated
+class DepthIndex {
+ public:
+  DepthIndex(price_t _min_price, price_t _max_price)
+      : min_price(std::min(_min_price, _max_price)),
+        max_price(std::max(_min_price, _max_price)),
+        quantity_tree(tree_size(_min_price, _max_price), 0),
+        notional_tree(quantity_tree.size(), 0) {}
+
+  // checked before the trees are sized, reversed bounds assert in debug
+  // builds and are swapped otherwise rather than wrapping the band width
+  static size_t tree_size(const price_t min_price, const price_t max_price) {
+    assert(min_price <= max_price);
+    return static_cast<size_t>(std::max(min_price, max_price) -
+                               std::min(min_price, max_price)) +
+           2;
+  }
+
+  inline bool contains(const price_t price) const {
+    return price >= min_price && price <= max_price;
+  }
+
+  void update(const price_t price, const int64_t quantity_delta) {
+    assert(contains(price));
+    int64_t const notional_delta = quantity_delta * price;
+    total_quantity += quantity_delta;
+    total_notional += notional_delta;
+    for (size_t i = to_index(price); i < quantity_tree.size(); i += i & -i) {
+      quantity_tree[i] += quantity_delta;
+      notional_tree[i] += notional_delta;
+    }
+  }
+
+  // sum of quantity at prices <= price
+  int64_t quantity_at_or_below(const price_t price) const {
+    if (price < min_price) return 0;
+    if (price >= max_price) return total_quantity;
+    return prefix(quantity_tree, to_index(price));
+  }
+
+  // sum of quantity at prices >= price
+  int64_t quantity_at_or_above(const price_t price) const {
+    if (price <= min_price) return total_quantity;
+    if (price > max_price) return 0;
+    return total_quantity - prefix(quantity_tree, to_index(price) - 1);
+  }
+
+  // take quantity starting from the lowest price (buying from the asks)
+  SweepCost sweep_from_low(const uint64_t quantity) const {
+    SweepCost cost;
+    // compare unsigned first so huge quantities cannot wrap negative
+    if (quantity == 0 || quantity > static_cast<uint64_t>(total_quantity)) {
+      return cost;
+    }
+    int64_t const wanted = static_cast<int64_t>(quantity);
+
+    // first index where the running quantity reaches what we want
+    size_t const idx = descend(wanted - 1) + 1;
+    cost.filled = true;
+    cost.worst_price = to_price(idx);
+    int64_t const below = prefix(quantity_tree, idx - 1);
+    cost.notional =
+        prefix(notional_tree, idx - 1) + (wanted - below) * cost.worst_price;
+    return cost;
+  }
+
+  // take quantity starting from the highest price (selling into the bids)
+  SweepCost sweep_from_high(const uint64_t quantity) const {
+    SweepCost cost;
+    // compare unsigned first so huge quantities cannot wrap negative
+    if (quantity == 0 || quantity > static_cast<uint64_t>(total_quantity)) {
+      return cost;
+    }
+    int64_t const wanted = static_cast<int64_t>(quantity);
+
+    // last index where the quantity left below it still covers the rest
+    size_t const idx = descend(total_quantity - wanted) + 1;
+    cost.filled = true;
+    cost.worst_price = to_price(idx);
+    int64_t const above = total_quantity - prefix(quantity_tree, idx);
+    cost.notional = (total_notional - prefix(notional_tree, idx)) +
+                    (wanted - above) * cost.worst_price;
+    return cost;
+  }
+
+  inline size_t to_index(const price_t price) const {
+    return static_cast<size_t>(price - min_price) + 1;
+  }
+
+  inline price_t to_price(const size_t idx) const {
+    return min_price + static_cast<price_t>(idx) - 1;
+  }
+
+  static int64_t prefix(const std::vector<int64_t>& tree, size_t idx) {
+    int64_t sum = 0;
+    for (; idx > 0; idx -= idx & -idx) sum += tree[idx];
+    return sum;
+  }
+
+  // largest index whose quantity prefix sum is <= target
+  size_t descend(int64_t target) const {
+    size_t pos = 0;
+    size_t const n = quantity_tree.size() - 1;
+    for (size_t step = std::bit_floor(n); step > 0; step >>= 1) {
+      if (pos + step <= n && quantity_tree[pos + step] <= target) {
+        pos += step;
+        target -= quantity_tree[pos];
+      }
+    }
+    return pos;
+  }
+
+  price_t min_price;
+  price_t max_price;
+  int64_t total_quantity{0};
+  int64_t total_notional{0};
+  // 1-indexed, slot 0 is unused
+  std::vector<int64_t> quantity_tree;
+  std::vector<int64_t> notional_tree;
+};
@@ -5,8 +5,11 @@
 #include <algorithm>
 #include <cassert>
 #include <map>
+#include <optional>
+#include <type_traits>
 #include <unordered_map>
 
+#include "DepthIndex.h"
 #include "MemoryPool.h"
 #include "PriceLevel.h"
 
@@ -54,6 +57,8 @@ class OrderBook {
     // update PriceLevel
     auto& [price_level, order_it] = order_level[id];
     price_level->total_quantity -= (it->second->quantity - new_quantity);
+    update_depth(it->second->side, it->second->price,
+                 static_cast<int64_t>(new_quantity) - it->second->quantity);
 
     // update OrderBook
     it->second->quantity = new_quantity;
@@ -104,6 +109,175 @@ class OrderBook {
     return result;
   }
 
+  // total resting quantity an order on side could take up to and including
+  // limit, i.e. Side::Buy walks the asks and Side::Sell walks the bids
+  uint64_t cumulative_quantity(const Side side, const price_t limit) const {
+    if (side == Side::Buy) {
+      return cumulative_side(asks, ask_index, ask_unindexed, limit);
+    }
+    return cumulative_side(bids, bid_index, bid_unindexed, limit);
+  }
+
+  // worst price an order on side reaches to fill quantity, empty if the
+  // opposite side does not hold enough quantity
+  std::optional<price_t> price_to_fill(const Side side,
+                                       const uint64_t quantity) const {
+    SweepCost const cost = sweep(side, quantity);
+    if (!cost.filled) return std::nullopt;
+    return cost.worst_price;
+  }
+
+  // volume weighted average price to fill quantity, empty if not fillable
+  std::optional<double> vwap_for_quantity(const Side side,
+                                          const uint64_t quantity) const {
+    SweepCost const cost = sweep(side, quantity);
+    if (!cost.filled) return std::nullopt;
+    return static_cast<double>(cost.notional) / static_cast<double>(quantity);
+  }
+
+  SweepCost sweep(const Side side, const uint64_t quantity) const {
+    if (side == Side::Buy) {
+      return sweep_side(asks, ask_index, ask_unindexed, quantity);
+    }
+    return sweep_side(bids, bid_index, bid_unindexed, quantity);
+  }
+
+  // keeps a cumulative quantity index over [min_price, max_price] so sweep
+  // queries are O(log(band width)) for the levels inside the band, levels
+  // outside it are walked on their own and combined with the band answer
+  void enable_depth_index(const price_t min_price, const price_t max_price) {
+    bid_index.emplace(min_price, max_price);
+    ask_index.emplace(min_price, max_price);
+    bid_unindexed = 0;
+    ask_unindexed = 0;
+    for (auto const& [price, price_level] : bids) {
+      update_depth(Side::Buy, price, price_level.total_quantity);
+    }
+    for (auto const& [price, price_level] : asks) {
+      update_depth(Side::Sell, price, price_level.total_quantity);
+    }
+  }
+
+  void disable_depth_index() {
+    bid_index.reset();
+    ask_index.reset();
+  }
+
+  // the asks are walked from the low end of the band, the bids from the high
+  template <typename Levels>
+  static constexpr bool walks_up() {
+    return std::is_same_v<typename Levels::key_compare, std::less<>>;
+  }
+
+  template <typename Levels>
+  static uint64_t cumulative_side(const Levels& levels,
+                                  const std::optional<DepthIndex>& index,
+                                  const int64_t unindexed,
+                                  const price_t limit) {
+    auto const comp = levels.key_comp();
+    if (!index) {
+      return cumulative_levels(levels.begin(), levels.end(), comp, limit);
+    }
+
+    int64_t const band = walks_up<Levels>()
+                             ? index->quantity_at_or_below(limit)
+                             : index->quantity_at_or_above(limit);
+    if (unindexed == 0) return static_cast<uint64_t>(band);
+
+    // only the levels beyond either edge of the band are walked
+    price_t const better_edge =
+        walks_up<Levels>() ? index->min_price : index->max_price;
+    price_t const worse_edge =
+        walks_up<Levels>() ? index->max_price : index->min_price;
+    return cumulative_levels(levels.begin(), levels.lower_bound(better_edge),
+                             comp, limit) +
+           static_cast<uint64_t>(band) +
+           cumulative_levels(levels.upper_bound(worse_edge), levels.end(),
+                             comp, limit);
+  }
+
+  template <typename Levels>
+  static SweepCost sweep_side(const Levels& levels,
+                              const std::optional<DepthIndex>& index,
+                              const int64_t unindexed,
+                              const uint64_t quantity) {
+    SweepCost cost;
+    if (quantity == 0) return cost;
+    uint64_t remaining = quantity;
+    if (!index) {
+      sweep_levels(levels.begin(), levels.end(), remaining, cost);
+      return cost;
+    }
+    if (unindexed == 0) {
+      return walks_up<Levels>() ? index->sweep_from_low(quantity)
+                                : index->sweep_from_high(quantity);
+    }
+
+    // levels better than the band, then the band, then levels worse than it
+    price_t const better_edge =
+        walks_up<Levels>() ? index->min_price : index->max_price;
+    price_t const worse_edge =
+        walks_up<Levels>() ? index->max_price : index->min_price;
+    sweep_levels(levels.begin(), levels.lower_bound(better_edge), remaining,
+                 cost);
+    if (cost.filled) return cost;
+
+    if (remaining <= static_cast<uint64_t>(index->total_quantity)) {
+      SweepCost const band = walks_up<Levels>()
+                                 ? index->sweep_from_low(remaining)
+                                 : index->sweep_from_high(remaining);
+      cost.filled = true;
+      cost.worst_price = band.worst_price;
+      cost.notional += band.notional;
+      return cost;
+    }
+    remaining -= static_cast<uint64_t>(index->total_quantity);
+    cost.notional += index->total_notional;
+
+    sweep_levels(levels.upper_bound(worse_edge), levels.end(), remaining, cost);
+    return cost;
+  }
+
+  template <typename It, typename Compare>
+  static uint64_t cumulative_levels(It first, It last, Compare comp,
+                                    const price_t limit) {
+    uint64_t total = 0;
+    for (; first != last; ++first) {
+      // stop once price is worse than limit for this side
+      if (comp(limit, first->first)) break;
+      total += first->second.total_quantity;
+    }
+    return total;
+  }
+
+  // takes from each level in turn until remaining is used up
+  template <typename It>
+  static void sweep_levels(It first, It last, uint64_t& remaining,
+                           SweepCost& cost) {
+    for (; first != last; ++first) {
+      uint64_t const taken =
+          std::min<uint64_t>(remaining, first->second.total_quantity);
+      cost.notional += static_cast<int64_t>(taken) * first->first;
+      remaining -= taken;
+      if (remaining == 0) {
+        cost.filled = true;
+        cost.worst_price = first->first;
+        return;
+      }
+    }
+  }
+
+  void update_depth(const Side side, const price_t price,
+                    const int64_t quantity_delta) {
+    auto& index = (side == Side::Buy ? bid_index : ask_index);
+    if (!index) return;
+    if (index->contains(price)) {
+      index->update(price, quantity_delta);
+    } else {
+      (side == Side::Buy ? bid_unindexed : ask_unindexed) += quantity_delta;
+    }
+  }
+
   void execute_match(Order& order, PriceLevel& price_level) {
     // executes a match from either side on a price_level
     // below conditions must hold and should be checked before calling
@@ -126,6 +300,7 @@ class OrderBook {
       auto curr = price_level.orders.front();
       quantity_t matched = std::min(curr->quantity, order.quantity);
       price_level.total_quantity -= matched;
+      update_depth(curr->side, curr->price, -static_cast<int64_t>(matched));
       curr->quantity -= matched;
       order.quantity -= matched;
       if (curr->quantity == 0) remove_order(curr->id);
@@ -149,6 +324,8 @@ class OrderBook {
     order_pool.insert({pooled_order->id, pooled_order});
     price_level->orders.push_back(pooled_order);
     price_level->total_quantity += pooled_order->quantity;
+    update_depth(pooled_order->side, pooled_order->price,
+                 pooled_order->quantity);
     auto order_it = std::prev(price_level->orders.end());
     order_level.insert({pooled_order->id, {price_level, order_it}});
   }
@@ -159,7 +336,10 @@ class OrderBook {
 
     // remove from PriceLevel
     auto [level, order_it] = order_level[id];
+    Order* order = it->second;  // order_it is invalid after the erase below
     level->total_quantity -= (*order_it)->quantity;
+    update_depth(it->second->side, it->second->price,
+                 -static_cast<int64_t>((*order_it)->quantity));
     level->orders.erase(order_it);
     if (level->orders.empty()) {
       remove_level(*level, it->second->side);
@@ -170,10 +350,12 @@ class OrderBook {
     order_level.erase(id);
 
     // remove from MemoryPool
-    mem_pool.release(*order_it);
+    mem_pool.release(order);
   }
 
   void remove_level(PriceLevel& price_level, Side side) {
+    update_depth(side, price_level.level,
+                 -static_cast<int64_t>(price_level.total_quantity));
     for (auto& order : price_level.orders) {
       // remove from OrderBook
       order_pool.erase(order->id);
@@ -199,4 +381,10 @@ class OrderBook {
   // store bids and asks in an ordered format for efficient processing
   std::map<price_t, PriceLevel, std::greater<>> bids;
   std::map<price_t, PriceLevel, std::less<>> asks;
+
+  // optional cumulative quantity index per side, see enable_depth_index
+  std::optional<DepthIndex> bid_index;
+  std::optional<DepthIndex> ask_index;
+  int64_t bid_unindexed{0};  // quantity resting outside the index band
+  int64_t ask_unindexed{0};
 };
@@ -0,0 +1,318 @@
+/* Primary/backup replication of an OrderBook over a local stream socket */
+
+#pragma once
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <type_traits>
+#include <vector>
+
+#include "OrderBook.h"
+
+enum class CommandType : uint8_t { Add, Modify, Cancel };
+
+// every input to the book is sequenced so both sides apply the same stream
+struct Command {
+  uint64_t sequence{0};
+  CommandType type{CommandType::Add};
+  Order order{};  // Modify uses id + quantity, Cancel uses id
+
+  Command() = default;
+  Command(CommandType _type, const Order& _order)
+      : type(_type), order(_order) {}
+};
+
+// commands and acks are sent as raw bytes between processes on one host
+static_assert(std::is_trivially_copyable_v<Command>);
+using ack_t = uint64_t;
+
+// book state is a pure function of the commands applied to it
+inline void apply_command(OrderBook& book, const Command& command) {
+  switch (command.type) {
+    case CommandType::Add: {
+      Order order = command.order;
+      book.add_order(order);
+      break;
+    }
+    case CommandType::Modify:
+      book.modify_order(command.order.id, command.order.quantity);
+      break;
+    case CommandType::Cancel:
+      book.cancel_order(command.order.id);
+      break;
+  }
+}
+
+// applies commands locally right away and streams them to the backup in
+// batches, acks are collected whenever the socket is touched so a batch send
+// only costs a non-blocking write while the backup keeps up. A batch goes out
+// once k_batch_size commands are buffered, callers must call flush() every
+// time their input queue drains or up to k_batch_size - 1 applied commands
+// wait unsent for as long as the book stays quiet. A backup that falls
+// behind fills the socket and flush() then applies back-pressure by waiting
+// up to timeout_ms for room before dropping the backup, after which the book
+// keeps running alone and commands are kept for resend_unacked.
+// The journal of unacked commands is capped at max_unacked, past that the
+// backup is dropped for good and a new one has to be seeded with a copy of
+// the book and attached with attach()
+class ReplicationPrimary {
+ public:
+  static int constexpr k_default_timeout_ms = 1000;
+  // far above what fits in the socket buffers while a backup keeps up
+  static size_t constexpr k_default_max_unacked = size_t{1} << 20;
+
+  ReplicationPrimary(int _fd, OrderBook& _book, uint64_t _sequence = 0,
+                     int _timeout_ms = k_default_timeout_ms)
+      : fd(_fd),
+        book(_book),
+        timeout_ms(_timeout_ms),
+        sequence(_sequence),
+        last_acked(_sequence) {
+    send_buffer.reserve(k_batch_size * sizeof(Command));
+  }
+
+  ReplicationPrimary(const ReplicationPrimary&) = delete;
+  ReplicationPrimary& operator=(const ReplicationPrimary&) = delete;
+
+  // applies the command and buffers it, see flush() for when it is sent
+  uint64_t submit(Command command) {
+    command.sequence = ++sequence;
+    if (connected) {
+      auto bytes = reinterpret_cast<const char*>(&command);
+      send_buffer.insert(send_buffer.end(), bytes, bytes + sizeof(Command));
+    }
+    if (!resync_required) {
+      unacked.push_back(command);
+      if (unacked.size() > max_unacked) drop_backup();
+    }
+    apply_command(book, command);
+
+    if (send_buffer.size() >= k_batch_size * sizeof(Command)) flush();
+    return command.sequence;
+  }
+
+  uint64_t add_order(const Order& order) {
+    return submit(Command(CommandType::Add, order));
+  }
+
+  uint64_t modify_order(const order_id_t id, const quantity_t new_quantity) {
+    Order order{};
+    order.id = id;
+    order.quantity = new_quantity;
+    return submit(Command(CommandType::Modify, order));
+  }
+
+  uint64_t cancel_order(const order_id_t id) {
+    Order order{};
+    order.id = id;
+    return submit(Command(CommandType::Cancel, order));
+  }
+
+  // pushes every buffered command to the socket, reading acks while the
+  // socket is full so neither side can block the other, blocks for at most
+  // timeout_ms without progress before giving up on the backup
+  void flush() {
+    size_t sent = 0;
+    while (connected && sent < send_buffer.size()) {
+      ssize_t n =
+          ::send(fd, send_buffer.data() + sent, send_buffer.size() - sent,
+                 MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (n > 0) {
+        sent += static_cast<size_t>(n);
+      } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        pollfd pfd{fd, POLLIN | POLLOUT, 0};
+        int const ready = ::poll(&pfd, 1, timeout_ms);
+        if (ready == 0) disconnect();
+        if (ready > 0 && (pfd.revents & POLLIN)) read_acks(MSG_DONTWAIT);
+      } else if (n < 0 && errno == EINTR) {
+        continue;
+      } else {
+        disconnect();
+      }
+    }
+    send_buffer.clear();
+    if (connected) read_acks(MSG_DONTWAIT);
+  }
+
+  // blocks until the backup has applied everything submitted so far,
+  // returns false if the backup went away or timeout_ms passed first
+  bool wait_for_acks() {
+    flush();
+    auto const deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(timeout_ms);
+    while (connected && last_acked < sequence) {
+      auto const left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      pollfd pfd{fd, POLLIN, 0};
+      if (left.count() <= 0 ||
+          ::poll(&pfd, 1, static_cast<int>(left.count())) == 0) {
+        disconnect();
+        break;
+      }
+      read_acks(MSG_DONTWAIT);
+    }
+    return connected;
+  }
+
+  // points the primary at a new backup connection and sends every command
+  // the old backup never acked, the backup must hold the book as of
+  // last_acked or later since anything it already applied is skipped, one
+  // that is further behind sees a gap and drops the connection unacked.
+  // Returns false without connecting once the journal was dropped
+  bool resend_unacked(int new_fd) {
+    if (resync_required) return false;
+    fd = new_fd;
+    connected = true;
+    ack_bytes = 0;
+    send_buffer.clear();
+    for (auto const& command : unacked) {
+      auto bytes = reinterpret_cast<const char*>(&command);
+      send_buffer.insert(send_buffer.end(), bytes, bytes + sizeof(Command));
+    }
+    flush();
+    return true;
+  }
+
+  // attaches a backup that already holds the book as of sequence, such as
+  // one seeded from a copy of the book, and starts a new journal
+  void attach(int new_fd) {
+    fd = new_fd;
+    connected = true;
+    resync_required = false;
+    ack_bytes = 0;
+    send_buffer.clear();
+    last_acked = sequence;
+    unacked.clear();
+  }
+
+  void read_acks(int flags) {
+    ssize_t n = ::recv(fd, ack_buffer + ack_bytes,
+                       sizeof(ack_buffer) - ack_bytes, flags);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                   errno != EINTR)) {
+      disconnect();
+      return;
+    }
+    if (n < 0) return;
+
+    ack_bytes += static_cast<size_t>(n);
+    size_t const complete = ack_bytes / sizeof(ack_t);
+    for (size_t i = 0; i < complete; ++i) {
+      ack_t ack;
+      std::memcpy(&ack, ack_buffer + i * sizeof(ack_t), sizeof(ack_t));
+      last_acked = std::max(last_acked, ack);
+    }
+    ack_bytes -= complete * sizeof(ack_t);
+    std::memmove(ack_buffer, ack_buffer + complete * sizeof(ack_t), ack_bytes);
+
+    while (!unacked.empty() && unacked.front().sequence <= last_acked) {
+      unacked.pop_front();
+    }
+  }
+
+  // the book keeps running without a backup, unacked is kept for a resend
+  void disconnect() {
+    connected = false;
+    send_buffer.clear();
+  }
+
+  // gives up on every backup of the current stream and frees the journal,
+  // only attach() can bring a backup back
+  void drop_backup() {
+    disconnect();
+    resync_required = true;
+    std::deque<Command>().swap(unacked);
+  }
+
+  static size_t constexpr k_batch_size = 64U;
+
+  int fd;
+  OrderBook& book;
+  int timeout_ms;
+  bool connected{true};
+  bool resync_required{false};  // journal dropped, see drop_backup
+  size_t max_unacked{k_default_max_unacked};
+  uint64_t sequence;    // last sequence submitted
+  uint64_t last_acked;  // last sequence the backup confirmed it applied
+  std::deque<Command> unacked;  // submitted but not yet acked, in order
+  std::vector<char> send_buffer;
+  char ack_buffer[64 * sizeof(ack_t)];
+  size_t ack_bytes{0};
+};
+
+// applies the primary's command stream to its own book and acks the last
+// applied sequence once per batch read off the socket
+class ReplicationBackup {
+ public:
+  ReplicationBackup(int _fd, OrderBook& _book) : fd(_fd), book(_book) {}
+
+  ReplicationBackup(const ReplicationBackup&) = delete;
+  ReplicationBackup& operator=(const ReplicationBackup&) = delete;
+
+  // blocks for the next batch, returns false once the primary is gone or
+  // the stream skips a sequence, a gap means this book is missing commands
+  // the primary already dropped so the connection is shut down unacked
+  bool poll() {
+    ssize_t n = ::recv(fd, recv_buffer + recv_bytes,
+                       sizeof(recv_buffer) - recv_bytes, 0);
+    if (n < 0 && errno == EINTR) return true;
+    if (n <= 0) return false;
+
+    recv_bytes += static_cast<size_t>(n);
+    size_t const complete = recv_bytes / sizeof(Command);
+    for (size_t i = 0; i < complete; ++i) {
+      Command command;
+      std::memcpy(&command, recv_buffer + i * sizeof(Command),
+                  sizeof(Command));
+      // a resent command that was already applied is skipped
+      if (command.sequence <= last_sequence) continue;
+      if (command.sequence != last_sequence + 1) {
+        recv_bytes = 0;
+        ::shutdown(fd, SHUT_RDWR);
+        return false;
+      }
+      apply_command(book, command);
+      last_sequence = command.sequence;
+    }
+    recv_bytes -= complete * sizeof(Command);
+    std::memmove(recv_buffer, recv_buffer + complete * sizeof(Command),
+                 recv_bytes);
+
+    if (complete > 0) {
+      ack_t ack = last_sequence;
+      // a lost ack is harmless, the next one covers it
+      ::send(fd, &ack, sizeof(ack), MSG_NOSIGNAL);
+    }
+    return true;
+  }
+
+  void run() {
+    while (poll()) {
+    }
+  }
+
+  // continues from last_sequence on a new connection from the primary
+  void reconnect(int new_fd) {
+    fd = new_fd;
+    recv_bytes = 0;
+  }
+
+  // the backup book becomes the primary and continues the same sequence,
+  // callers resubmit anything after last_sequence they did not see acked
+  ReplicationPrimary take_over(int new_fd) {
+    return ReplicationPrimary(new_fd, book, last_sequence);
+  }
+
+  int fd;
+  OrderBook& book;
+  uint64_t last_sequence{0};  // last sequence applied to book
+  char recv_buffer[ReplicationPrimary::k_batch_size * sizeof(Command)];
+  size_t recv_bytes{0};
+};
@@ -0,0 +1,19 @@
+/* Small deterministic generator shared by the unit and perf tests */
+
+#pragma once
+
+#include <cstdint>
+
+// xorshift64, fast and reproducible so failures replay exactly
+struct Xorshift {
+  uint64_t state;
+
+  explicit Xorshift(uint64_t seed = 88172645463325252ULL) : state(seed) {}
+
+  uint64_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+};
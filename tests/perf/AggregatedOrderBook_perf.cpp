@@ -0,0 +1,30 @@
+/* Replay L2 level updates across many symbols and perf record the hot path */
+
+#include <vector>
+
+#include "AggregatedOrderBook.h"
+#include "Xorshift.h"
+
+int main() {
+  size_t constexpr k_num_symbols = 4096U;
+  size_t constexpr k_num_updates = 10000000U;
+  std::vector<AggregatedOrderBook> books(k_num_symbols);
+
+  // updates cluster around the top of book like a real feed does
+  Xorshift rng;
+  for (size_t update = 0; update < k_num_updates; ++update) {
+    uint64_t const state = rng.next();
+
+    auto& book = books[state % k_num_symbols];
+    Side side = ((state >> 12) & 1) ? Side::Buy : Side::Sell;
+    price_t offset = static_cast<price_t>((state >> 16) % 32);
+    price_t price = (side == Side::Buy) ? 10000 - offset : 10001 + offset;
+    quantity_t quantity = static_cast<quantity_t>((state >> 24) % 8) * 100;
+    book.update_level(side, price, quantity);
+    book.get_top();
+  }
+
+  (void)books;
+
+  return 0;
+}
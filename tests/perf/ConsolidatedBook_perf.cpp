@@ -0,0 +1,100 @@
+/* Time consolidated BBO and merged depth after every single venue update */
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "ConsolidatedBook.h"
+#include "Xorshift.h"
+
+void run(size_t num_venues) {
+  size_t constexpr k_depth = 10U;
+  size_t constexpr k_num_updates = 1000000U;
+  std::vector<AggregatedOrderBook> venues(num_venues);
+  ConsolidatedBook consolidated(num_venues, k_depth);
+
+  // venues quote the same instrument around their own mid a few ticks
+  // apart from each other, so many merged levels are held up by one venue
+  price_t mid = 10000;
+  std::vector<price_t> venue_mids(num_venues, mid);
+  std::vector<LevelInfo> bid_levels;
+  std::vector<LevelInfo> ask_levels;
+  auto requote = [&](size_t venue, uint64_t r) {
+    price_t const venue_mid = venue_mids[venue];
+    bid_levels.clear();
+    ask_levels.clear();
+    for (price_t level = 0; level < 10; ++level) {
+      quantity_t quantity = static_cast<quantity_t>((r >> level) % 8 + 1) * 100;
+      bid_levels.emplace_back(venue_mid - 2 * level, quantity, 0);
+      ask_levels.emplace_back(venue_mid + 1 + 2 * level, quantity, 0);
+    }
+    venues[venue].apply_snapshot(bid_levels, ask_levels);
+    consolidated.update_venue(venue, venues[venue]);
+  };
+
+  Xorshift rng;
+  for (size_t v = 0; v < num_venues; ++v) {
+    venue_mids[v] = mid + static_cast<price_t>(v % 5) - 2;
+    requote(v, rng.next());
+  }
+
+  uint64_t const initial_merges =
+      consolidated.bids.full_merges + consolidated.asks.full_merges;
+  size_t bbo_changes = 0;
+  BookTop last_top = consolidated.get_top();
+  auto start = std::chrono::steady_clock::now();
+  for (size_t update = 0; update < k_num_updates; ++update) {
+    uint64_t const r = rng.next();
+    // the shared mid wanders so the top of book keeps moving across venues
+    if (update % 64 == 0) mid += ((r >> 40) & 1) ? 1 : -1;
+
+    size_t venue = r % num_venues;
+    auto& book = venues[venue];
+    uint64_t const kind = (r >> 16) % 10;
+    if (kind < 6) {
+      // most feed updates change the quantity at the venue's best level
+      Side side = ((r >> 12) & 1) ? Side::Buy : Side::Sell;
+      auto const& levels =
+          (side == Side::Buy) ? book.bids.levels : book.asks.levels;
+      quantity_t quantity = static_cast<quantity_t>((r >> 28) % 8 + 1) * 100;
+      if (!levels.empty()) {
+        book.update_level(side, levels.back().price, quantity);
+        consolidated.update_venue(venue, book);
+      }
+    } else if (kind < 8) {
+      // a level inside the venue's ladder is pulled or added back
+      Side side = ((r >> 12) & 1) ? Side::Buy : Side::Sell;
+      price_t const offset = 2 * static_cast<price_t>((r >> 20) % 10);
+      price_t const price = (side == Side::Buy)
+                                ? venue_mids[venue] - offset
+                                : venue_mids[venue] + 1 + offset;
+      quantity_t quantity = ((r >> 24) & 1) ? 0 : 100;
+      book.update_level(side, price, quantity);
+      consolidated.update_venue(venue, book);
+    } else {
+      // the venue re-centres its ladder on the shared mid
+      venue_mids[venue] = mid + static_cast<price_t>((r >> 32) % 5) - 2;
+      requote(venue, r);
+    }
+
+    BookTop const top = consolidated.get_top();
+    bbo_changes += (top.bid_price != last_top.bid_price ||
+                    top.ask_price != last_top.ask_price);
+    last_top = top;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  auto ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  uint64_t const merges = consolidated.bids.full_merges +
+                         consolidated.asks.full_merges - initial_merges;
+  std::cout << num_venues << " venues: "
+            << static_cast<double>(ns) / k_num_updates << " ns/update, "
+            << 100.0 * static_cast<double>(merges) / k_num_updates
+            << "% full merges, " << bbo_changes << " BBO price changes\n";
+}
+
+int main() {
+  for (size_t num_venues : {16U, 32U, 48U, 64U}) run(num_venues);
+  return 0;
+}
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+
+#include "AggregatedOrderBook.h"
+
+class AggregatedOrderBookUnitTest : public ::testing::Test {
+ protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+TEST_F(AggregatedOrderBookUnitTest, UpdateLevelBasic) {
+  AggregatedOrderBook book;
+
+  // verify empty book
+  BookTop empty_top = book.get_top();
+  EXPECT_EQ(empty_top.bid_price, 0);
+  EXPECT_EQ(empty_top.bid_quantity, 0);
+  EXPECT_EQ(empty_top.ask_price, 0);
+  EXPECT_EQ(empty_top.ask_quantity, 0);
+
+  // add levels out of order
+  book.update_level(Side::Buy, 100, 10);
+  book.update_level(Side::Buy, 102, 5);
+  book.update_level(Side::Buy, 101, 7);
+  book.update_level(Side::Sell, 105, 3);
+  book.update_level(Side::Sell, 103, 8);
+  book.update_level(Side::Sell, 104, 4);
+
+  EXPECT_EQ(book.bid_depth(), 3);
+  EXPECT_EQ(book.ask_depth(), 3);
+
+  BookTop top = book.get_top();
+  EXPECT_EQ(top.bid_price, 102);
+  EXPECT_EQ(top.bid_quantity, 5);
+  EXPECT_EQ(top.ask_price, 103);
+  EXPECT_EQ(top.ask_quantity, 8);
+  EXPECT_EQ(top.spread(), 1);
+
+  // overwrite an existing level
+  book.update_level(Side::Buy, 102, 50);
+  EXPECT_EQ(book.bid_depth(), 3);
+  EXPECT_EQ(book.get_top().bid_quantity, 50);
+
+  // remove the best ask level
+  book.update_level(Side::Sell, 103, 0);
+  EXPECT_EQ(book.ask_depth(), 2);
+  EXPECT_EQ(book.get_top().ask_price, 104);
+  EXPECT_EQ(book.get_top().ask_quantity, 4);
+
+  // removing a level that does not exist changes nothing
+  book.update_level(Side::Sell, 200, 0);
+  book.update_level(Side::Buy, 1, 0);
+  EXPECT_EQ(book.bid_depth(), 3);
+  EXPECT_EQ(book.ask_depth(), 2);
+}
+
+TEST_F(AggregatedOrderBookUnitTest, GetDepthComplex) {
+  AggregatedOrderBook book;
+
+  EXPECT_TRUE(book.get_bids(5).empty());
+  EXPECT_TRUE(book.get_asks(5).empty());
+
+  book.update_level(Side::Buy, 104, 50);
+  book.update_level(Side::Buy, 100, 40);
+  book.update_level(Side::Buy, 105, 30);
+  book.update_level(Side::Buy, 102, 25);
+  book.update_level(Side::Sell, 110, 30);
+  book.update_level(Side::Sell, 106, 30);
+  book.update_level(Side::Sell, 108, 22);
+
+  // verify bid ordering (descending) and values
+  auto all_bids = book.get_bids(book.bid_depth() + 5);
+  EXPECT_EQ(all_bids.size(), 4);
+  EXPECT_EQ(all_bids[0].price, 105);
+  EXPECT_EQ(all_bids[0].quantity, 30);
+  EXPECT_EQ(all_bids[0].order_count, 0);
+  EXPECT_EQ(all_bids[1].price, 104);
+  EXPECT_EQ(all_bids[1].quantity, 50);
+  EXPECT_EQ(all_bids[2].price, 102);
+  EXPECT_EQ(all_bids[2].quantity, 25);
+  EXPECT_EQ(all_bids[3].price, 100);
+  EXPECT_EQ(all_bids[3].quantity, 40);
+
+  // verify ask ordering (ascending) and values
+  auto all_asks = book.get_asks(book.ask_depth());
+  EXPECT_EQ(all_asks.size(), 3);
+  EXPECT_EQ(all_asks[0].price, 106);
+  EXPECT_EQ(all_asks[0].quantity, 30);
+  EXPECT_EQ(all_asks[1].price, 108);
+  EXPECT_EQ(all_asks[1].quantity, 22);
+  EXPECT_EQ(all_asks[2].price, 110);
+  EXPECT_EQ(all_asks[2].quantity, 30);
+
+  // limited and zero depth requests
+  auto top_2_bids = book.get_bids(2);
+  EXPECT_EQ(top_2_bids.size(), 2);
+  EXPECT_EQ(top_2_bids[0].price, 105);
+  EXPECT_EQ(top_2_bids[1].price, 104);
+  EXPECT_TRUE(book.get_bids(0).empty());
+  EXPECT_TRUE(book.get_asks(0).empty());
+}
+
+TEST_F(AggregatedOrderBookUnitTest, ApplySnapshot) {
+  AggregatedOrderBook book;
+
+  book.update_level(Side::Buy, 50, 1);
+  book.update_level(Side::Sell, 60, 1);
+
+  // bids arrive best first, asks arrive unordered with an empty level
+  std::vector<LevelInfo> bid_levels{{105, 10, 0}, {104, 20, 0}, {101, 5, 0}};
+  std::vector<LevelInfo> ask_levels{{108, 7, 0}, {106, 3, 0}, {107, 0, 0}};
+  book.apply_snapshot(bid_levels, ask_levels);
+
+  // previous levels are replaced
+  EXPECT_EQ(book.bid_depth(), 3);
+  EXPECT_EQ(book.ask_depth(), 2);
+
+  auto bids = book.get_bids(3);
+  EXPECT_EQ(bids[0].price, 105);
+  EXPECT_EQ(bids[1].price, 104);
+  EXPECT_EQ(bids[2].price, 101);
+
+  auto asks = book.get_asks(3);
+  EXPECT_EQ(asks.size(), 2);
+  EXPECT_EQ(asks[0].price, 106);
+  EXPECT_EQ(asks[0].quantity, 3);
+  EXPECT_EQ(asks[1].price, 108);
+  EXPECT_EQ(asks[1].quantity, 7);
+
+  // incremental updates continue on top of the snapshot
+  book.update_level(Side::Buy, 106, 4);
+  book.update_level(Side::Sell, 106, 0);
+  BookTop top = book.get_top();
+  EXPECT_EQ(top.bid_price, 106);
+  EXPECT_EQ(top.bid_quantity, 4);
+  EXPECT_EQ(top.ask_price, 108);
+  EXPECT_EQ(top.ask_quantity, 7);
+
+  book.clear();
+  EXPECT_EQ(book.bid_depth(), 0);
+  EXPECT_EQ(book.ask_depth(), 0);
+}
+
+TEST_F(AggregatedOrderBookUnitTest, ApplySnapshotRepeatedPrices) {
+  AggregatedOrderBook book;
+
+  // repeated prices keep the last quantity given, both when the snapshot is
+  // already ordered and when it has to be sorted
+  std::vector<LevelInfo> bid_levels{
+      {105, 10, 0}, {105, 12, 0}, {104, 20, 0}, {104, 0, 0}, {103, 5, 0}};
+  std::vector<LevelInfo> ask_levels{
+      {108, 7, 0}, {106, 3, 0}, {108, 9, 0}, {107, 0, 0}, {107, 4, 0}};
+  book.apply_snapshot(bid_levels, ask_levels);
+
+  EXPECT_EQ(book.bid_depth(), 2);
+  auto bids = book.get_bids(5);
+  ASSERT_EQ(bids.size(), 2);
+  EXPECT_EQ(bids[0].price, 105);
+  EXPECT_EQ(bids[0].quantity, 12);
+  EXPECT_EQ(bids[1].price, 103);
+  EXPECT_EQ(bids[1].quantity, 5);
+
+  EXPECT_EQ(book.ask_depth(), 3);
+  auto asks = book.get_asks(5);
+  ASSERT_EQ(asks.size(), 3);
+  EXPECT_EQ(asks[0].price, 106);
+  EXPECT_EQ(asks[0].quantity, 3);
+  EXPECT_EQ(asks[1].price, 107);
+  EXPECT_EQ(asks[1].quantity, 4);
+  EXPECT_EQ(asks[2].price, 108);
+  EXPECT_EQ(asks[2].quantity, 9);
+
+  // a later update removes the single remaining level at that price
+  book.update_level(Side::Sell, 108, 0);
+  EXPECT_EQ(book.ask_depth(), 2);
+  EXPECT_EQ(book.get_asks(5).back().price, 107);
+}
+
+TEST_F(AggregatedOrderBookUnitTest, MatchesOrderBookLevels) {
+  OrderBook full_book;
+  AggregatedOrderBook agg_book;
+
+  Order b1(1, Side::Buy, 105, 10, 1);
+  Order b2(2, Side::Buy, 104, 20, 2);
+  Order b3(3, Side::Buy, 105, 15, 3);
+  Order a1(4, Side::Sell, 106, 12, 4);
+  Order a2(5, Side::Sell, 107, 8, 5);
+  Order a3(6, Side::Sell, 106, 18, 6);
+  for (Order* order : {&b1, &b2, &b3, &a1, &a2, &a3}) {
+    full_book.add_order(*order);
+  }
+
+  // rebuild the aggregated book from the full book's levels
+  agg_book.apply_snapshot(full_book.get_bids(10), full_book.get_asks(10));
+
+  auto full_bids = full_book.get_bids(10);
+  auto agg_bids = agg_book.get_bids(10);
+  ASSERT_EQ(full_bids.size(), agg_bids.size());
+  for (size_t i = 0; i < full_bids.size(); ++i) {
+    EXPECT_EQ(full_bids[i].price, agg_bids[i].price);
+    EXPECT_EQ(full_bids[i].quantity, agg_bids[i].quantity);
+  }
+
+  auto full_asks = full_book.get_asks(10);
+  auto agg_asks = agg_book.get_asks(10);
+  ASSERT_EQ(full_asks.size(), agg_asks.size());
+  for (size_t i = 0; i < full_asks.size(); ++i) {
+    EXPECT_EQ(full_asks[i].price, agg_asks[i].price);
+    EXPECT_EQ(full_asks[i].quantity, agg_asks[i].quantity);
+  }
+
+  BookTop full_top = full_book.get_top();
+  BookTop agg_top = agg_book.get_top();
+  EXPECT_EQ(full_top.bid_price, agg_top.bid_price);
+  EXPECT_EQ(full_top.bid_quantity, agg_top.bid_quantity);
+  EXPECT_EQ(full_top.ask_price, agg_top.ask_price);
+  EXPECT_EQ(full_top.ask_quantity, agg_top.ask_quantity);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,233 @@
+#include <gtest/gtest.h>
+
+#include <map>
+
+#include "ConsolidatedBook.h"
+#include "Xorshift.h"
+
+class ConsolidatedBookUnitTest : public ::testing::Test {
+ protected:
+  void SetUp() override {}
+  void TearDown() override {}
+
+  // merges every venue's top levels with a map, the slow obvious way
+  template <typename Compare>
+  static std::vector<ConsolidatedLevel> reference_merge(
+      const std::vector<std::vector<LevelInfo>>& venue_levels, size_t depth) {
+    std::map<price_t, ConsolidatedLevel, Compare> levels;
+    for (size_t v = 0; v < venue_levels.size(); ++v) {
+      for (auto const& level : venue_levels[v]) {
+        auto& merged = levels[level.price];
+        merged.price = level.price;
+        merged.quantity += level.quantity;
+        merged.venues |= uint64_t{1} << v;
+      }
+    }
+    std::vector<ConsolidatedLevel> result;
+    for (auto const& [price, level] : levels) {
+      (void)price;
+      if (result.size() == depth) break;
+      result.push_back(level);
+    }
+    return result;
+  }
+
+  static void expect_same_levels(const std::vector<ConsolidatedLevel>& lhs,
+                                 const std::vector<ConsolidatedLevel>& rhs) {
+    ASSERT_EQ(lhs.size(), rhs.size());
+    for (size_t i = 0; i < lhs.size(); ++i) {
+      EXPECT_EQ(lhs[i].price, rhs[i].price);
+      EXPECT_EQ(lhs[i].quantity, rhs[i].quantity);
+      EXPECT_EQ(lhs[i].venues, rhs[i].venues);
+    }
+  }
+};
+
+TEST_F(ConsolidatedBookUnitTest, MergeBasic) {
+  ConsolidatedBook consolidated(3, 3);
+
+  // verify empty book
+  BookTop empty_top = consolidated.get_top();
+  EXPECT_EQ(empty_top.bid_price, 0);
+  EXPECT_EQ(empty_top.ask_price, 0);
+  EXPECT_TRUE(consolidated.get_bids().empty());
+  EXPECT_TRUE(consolidated.get_asks().empty());
+
+  OrderBook venue0;
+  OrderBook venue1;
+  AggregatedOrderBook venue2;
+
+  Order b1(1, Side::Buy, 100, 10, 1);
+  Order b2(2, Side::Buy, 99, 20, 2);
+  Order a1(3, Side::Sell, 102, 5, 3);
+  venue0.add_order(b1);
+  venue0.add_order(b2);
+  venue0.add_order(a1);
+
+  Order b3(4, Side::Buy, 100, 7, 4);
+  Order a2(5, Side::Sell, 101, 8, 5);
+  Order a3(6, Side::Sell, 102, 9, 6);
+  venue1.add_order(b3);
+  venue1.add_order(a2);
+  venue1.add_order(a3);
+
+  venue2.update_level(Side::Buy, 98, 30);
+  venue2.update_level(Side::Buy, 97, 40);
+  venue2.update_level(Side::Sell, 103, 1);
+
+  consolidated.update_venue(0, venue0);
+  consolidated.update_venue(1, venue1);
+  consolidated.update_venue(2, venue2);
+
+  BookTop top = consolidated.get_top();
+  EXPECT_EQ(top.bid_price, 100);
+  EXPECT_EQ(top.bid_quantity, 17);
+  EXPECT_EQ(top.ask_price, 101);
+  EXPECT_EQ(top.ask_quantity, 8);
+
+  // bids are cut off at depth 3, 97 is not included
+  auto const& bids = consolidated.get_bids();
+  ASSERT_EQ(bids.size(), 3);
+  EXPECT_EQ(bids[0].price, 100);
+  EXPECT_EQ(bids[0].quantity, 17);
+  EXPECT_EQ(bids[0].venues, 0b011);
+  EXPECT_EQ(bids[1].price, 99);
+  EXPECT_EQ(bids[1].quantity, 20);
+  EXPECT_EQ(bids[1].venues, 0b001);
+  EXPECT_EQ(bids[2].price, 98);
+  EXPECT_EQ(bids[2].quantity, 30);
+  EXPECT_EQ(bids[2].venues, 0b100);
+
+  auto const& asks = consolidated.get_asks();
+  ASSERT_EQ(asks.size(), 3);
+  EXPECT_EQ(asks[0].price, 101);
+  EXPECT_EQ(asks[0].venues, 0b010);
+  EXPECT_EQ(asks[1].price, 102);
+  EXPECT_EQ(asks[1].quantity, 14);
+  EXPECT_EQ(asks[1].venues, 0b011);
+  EXPECT_EQ(asks[2].price, 103);
+  EXPECT_EQ(asks[2].venues, 0b100);
+
+  // a venue emptying out drops it from every level
+  venue1.cancel_order(4);
+  venue1.cancel_order(5);
+  venue1.cancel_order(6);
+  consolidated.update_venue(1, venue1);
+
+  top = consolidated.get_top();
+  EXPECT_EQ(top.bid_price, 100);
+  EXPECT_EQ(top.bid_quantity, 10);
+  EXPECT_EQ(top.ask_price, 102);
+  EXPECT_EQ(top.ask_quantity, 5);
+  EXPECT_EQ(consolidated.get_bids()[0].venues, 0b001);
+  EXPECT_EQ(consolidated.get_asks().size(), 2);
+}
+
+TEST_F(ConsolidatedBookUnitTest, MatchesReferenceMerge) {
+  size_t constexpr k_num_venues = 37;  // not a multiple of the SIMD width
+  size_t constexpr k_depth = 5;
+  ConsolidatedBook consolidated(k_num_venues, k_depth);
+  std::vector<AggregatedOrderBook> venues(k_num_venues);
+
+  Xorshift rng;
+  for (size_t update = 0; update < 20000; ++update) {
+    uint64_t const state = rng.next();
+
+    size_t venue = state % k_num_venues;
+    Side side = ((state >> 12) & 1) ? Side::Buy : Side::Sell;
+    price_t offset = static_cast<price_t>((state >> 16) % 12);
+    price_t price = (side == Side::Buy) ? 1000 - offset : 1001 + offset;
+    quantity_t quantity = static_cast<quantity_t>((state >> 24) % 4) * 10;
+    venues[venue].update_level(side, price, quantity);
+    consolidated.update_venue(venue, venues[venue]);
+
+    std::vector<std::vector<LevelInfo>> venue_bids;
+    std::vector<std::vector<LevelInfo>> venue_asks;
+    for (auto const& book : venues) {
+      venue_bids.push_back(book.get_bids(k_depth));
+      venue_asks.push_back(book.get_asks(k_depth));
+    }
+    expect_same_levels(consolidated.get_bids(),
+                       reference_merge<std::greater<>>(venue_bids, k_depth));
+    expect_same_levels(consolidated.get_asks(),
+                       reference_merge<std::less<>>(venue_asks, k_depth));
+    if (HasFailure()) FAIL() << "diverged at update " << update;
+  }
+}
+
+TEST_F(ConsolidatedBookUnitTest, QuantityChangesStayIncremental) {
+  size_t constexpr k_num_venues = 32;
+  size_t constexpr k_depth = 10;
+  ConsolidatedBook consolidated(k_num_venues, k_depth);
+  std::vector<AggregatedOrderBook> venues(k_num_venues);
+
+  // venues quote at slightly different prices so many merged levels have a
+  // single venue behind them
+  for (size_t v = 0; v < k_num_venues; ++v) {
+    price_t const skew = static_cast<price_t>(v % 7);
+    for (price_t offset = 0; offset < 10; ++offset) {
+      venues[v].update_level(Side::Buy, 1000 - skew - 3 * offset, 100);
+      venues[v].update_level(Side::Sell, 1001 + skew + 3 * offset, 100);
+    }
+    consolidated.update_venue(v, venues[v]);
+  }
+  uint64_t const bid_merges = consolidated.bids.full_merges;
+  uint64_t const ask_merges = consolidated.asks.full_merges;
+
+  // quantity only changes at each venue's best levels never need a merge
+  Xorshift rng;
+  for (size_t update = 0; update < 10000; ++update) {
+    uint64_t const r = rng.next();
+    size_t venue = r % k_num_venues;
+    auto& book = venues[venue];
+    quantity_t quantity = static_cast<quantity_t>((r >> 24) % 500) + 1;
+    if ((r >> 12) & 1) {
+      book.update_level(Side::Buy, book.bids.best().price, quantity);
+    } else {
+      book.update_level(Side::Sell, book.asks.best().price, quantity);
+    }
+    consolidated.update_venue(venue, book);
+  }
+  EXPECT_EQ(consolidated.bids.full_merges, bid_merges);
+  EXPECT_EQ(consolidated.asks.full_merges, ask_merges);
+
+  std::vector<std::vector<LevelInfo>> venue_bids;
+  for (auto const& book : venues) venue_bids.push_back(book.get_bids(k_depth));
+  expect_same_levels(consolidated.get_bids(),
+                     reference_merge<std::greater<>>(venue_bids, k_depth));
+}
+
+TEST_F(ConsolidatedBookUnitTest, TopQuantitySaturates) {
+  size_t constexpr k_num_venues = 4;
+  ConsolidatedBook consolidated(k_num_venues, 2);
+  quantity_t constexpr k_max = std::numeric_limits<quantity_t>::max();
+
+  AggregatedOrderBook venue;
+  venue.update_level(Side::Buy, 100, k_max);
+  venue.update_level(Side::Sell, 101, 1);
+  for (size_t v = 0; v < k_num_venues; ++v) consolidated.update_venue(v, venue);
+
+  // the top of book saturates while the ladder keeps the full total
+  EXPECT_EQ(consolidated.get_top().bid_quantity, k_max);
+  EXPECT_EQ(consolidated.get_top().ask_quantity, 4);
+  EXPECT_EQ(consolidated.get_bids()[0].quantity, uint64_t{k_max} * 4);
+}
+
+TEST_F(ConsolidatedBookUnitTest, SimdKernels) {
+  std::vector<int64_t> keys(64, ConsolidatedSide::k_empty);
+  EXPECT_EQ(simd::max(keys.data(), keys.size()), ConsolidatedSide::k_empty);
+
+  keys[5] = -20;
+  keys[63] = 7;
+  keys[32] = 7;
+  keys[0] = -3;
+  EXPECT_EQ(simd::max(keys.data(), keys.size()), 7);
+  EXPECT_EQ(simd::equal_mask(keys.data(), keys.size(), 7),
+            (uint64_t{1} << 63) | (uint64_t{1} << 32));
+  EXPECT_EQ(simd::equal_mask(keys.data(), 8, -20), uint64_t{1} << 5);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <limits>
+
 #include "OrderBook.h"
+#include "Xorshift.h"
 
 class OrderBookUnitTest : public ::testing::Test {
  protected:
@@ -392,6 +395,143 @@ TEST_F(OrderBookUnitTest, GetDepthComplex) {
   EXPECT_EQ(book.ask_depth(), 2);
 }
 
+TEST_F(OrderBookUnitTest, SweepQueries) {
+  OrderBook book;
+
+  // empty book cannot fill anything
+  EXPECT_EQ(book.cumulative_quantity(Side::Buy, 1000), 0);
+  EXPECT_FALSE(book.price_to_fill(Side::Buy, 1).has_value());
+  EXPECT_FALSE(book.vwap_for_quantity(Side::Sell, 1).has_value());
+
+  Order b1(1, Side::Buy, 105, 10, 1);
+  Order b2(2, Side::Buy, 104, 20, 2);
+  Order b3(3, Side::Buy, 102, 30, 3);
+  Order a1(4, Side::Sell, 106, 12, 4);
+  Order a2(5, Side::Sell, 108, 8, 5);
+  Order a3(6, Side::Sell, 106, 18, 6);
+  for (Order* order : {&b1, &b2, &b3, &a1, &a2, &a3}) book.add_order(*order);
+
+  // buying walks the asks (106: 30, 108: 8)
+  EXPECT_EQ(book.cumulative_quantity(Side::Buy, 105), 0);
+  EXPECT_EQ(book.cumulative_quantity(Side::Buy, 106), 30);
+  EXPECT_EQ(book.cumulative_quantity(Side::Buy, 107), 30);
+  EXPECT_EQ(book.cumulative_quantity(Side::Buy, 108), 38);
+  EXPECT_EQ(book.price_to_fill(Side::Buy, 30), 106);
+  EXPECT_EQ(book.price_to_fill(Side::Buy, 31), 108);
+  EXPECT_FALSE(book.price_to_fill(Side::Buy, 39).has_value());
+  EXPECT_DOUBLE_EQ(book.vwap_for_quantity(Side::Buy, 34).value(),
+                   (30.0 * 106 + 4.0 * 108) / 34);
+
+  // selling walks the bids (105: 10, 104: 20, 102: 30)
+  EXPECT_EQ(book.cumulative_quantity(Side::Sell, 106), 0);
+  EXPECT_EQ(book.cumulative_quantity(Side::Sell, 104), 30);
+  EXPECT_EQ(book.cumulative_quantity(Side::Sell, 0), 60);
+  EXPECT_EQ(book.price_to_fill(Side::Sell, 10), 105);
+  EXPECT_EQ(book.price_to_fill(Side::Sell, 31), 102);
+  EXPECT_FALSE(book.price_to_fill(Side::Sell, 0).has_value());
+  EXPECT_DOUBLE_EQ(book.vwap_for_quantity(Side::Sell, 60).value(),
+                   (10.0 * 105 + 20.0 * 104 + 30.0 * 102) / 60);
+
+  // the index must agree with the walk, including levels outside its band
+  SweepCost walk_buy = book.sweep(Side::Buy, 34);
+  book.enable_depth_index(103, 110);
+  EXPECT_EQ(book.bid_unindexed, 30);
+  EXPECT_EQ(book.cumulative_quantity(Side::Buy, 107), 30);
+  EXPECT_EQ(book.sweep(Side::Buy, 34).notional, walk_buy.notional);
+  EXPECT_EQ(book.price_to_fill(Side::Sell, 31), 102);
+
+  book.cancel_order(3);
+  EXPECT_EQ(book.bid_unindexed, 0);
+  EXPECT_EQ(book.cumulative_quantity(Side::Sell, 0), 30);
+  EXPECT_EQ(book.price_to_fill(Side::Sell, 30), 104);
+  EXPECT_FALSE(book.price_to_fill(Side::Sell, 31).has_value());
+  EXPECT_DOUBLE_EQ(book.vwap_for_quantity(Side::Sell, 15).value(),
+                   (10.0 * 105 + 5.0 * 104) / 15);
+}
+
+TEST_F(OrderBookUnitTest, SweepQueriesIndexMatchesWalk) {
+  // no index, an index covering every price, and a narrow index that leaves
+  // levels on both sides of its band to be walked
+  OrderBook books[3];
+  books[1].enable_depth_index(900, 1100);
+  books[2].enable_depth_index(985, 1015);
+
+  // drive the books through adds, matches, modifies and cancels
+  Xorshift rng;
+  bool saw_unindexed = false;
+  for (order_id_t id = 1; id <= 5000; ++id) {
+    uint64_t const r = rng.next();
+    if (r % 10 < 7) {
+      Side side = (r & 16) ? Side::Buy : Side::Sell;
+      price_t offset = static_cast<price_t>((r >> 8) % 60);
+      price_t price = (side == Side::Buy) ? 1010 - offset : 990 + offset;
+      quantity_t quantity = static_cast<quantity_t>((r >> 20) % 50) + 1;
+      for (auto& book : books) {
+        Order order(id, side, price, quantity, id);
+        book.add_order(order);
+      }
+    } else if (r % 10 < 9) {
+      order_id_t target = (r >> 8) % id;
+      for (auto& book : books) book.cancel_order(target);
+    } else {
+      order_id_t target = (r >> 8) % id;
+      quantity_t quantity = static_cast<quantity_t>((r >> 20) % 50) + 1;
+      for (auto& book : books) book.modify_order(target, quantity);
+    }
+    saw_unindexed |= (books[2].bid_unindexed > 0 && books[2].ask_unindexed > 0);
+
+    uint64_t const quantity = (rng.next() % 1500) + 1;
+    price_t const limit = 950 + static_cast<price_t>(rng.next() % 100);
+    for (Side side : {Side::Buy, Side::Sell}) {
+      SweepCost walk_cost = books[0].sweep(side, quantity);
+      for (size_t i = 1; i < 3; ++i) {
+        ASSERT_EQ(books[0].cumulative_quantity(side, limit),
+                  books[i].cumulative_quantity(side, limit));
+        SweepCost index_cost = books[i].sweep(side, quantity);
+        ASSERT_EQ(walk_cost.filled, index_cost.filled);
+        if (!walk_cost.filled) continue;
+        ASSERT_EQ(walk_cost.worst_price, index_cost.worst_price);
+        ASSERT_EQ(walk_cost.notional, index_cost.notional);
+      }
+    }
+  }
+  EXPECT_TRUE(saw_unindexed);
+}
+
+TEST_F(OrderBookUnitTest, SweepQueriesEdgeCases) {
+  OrderBook book;
+
+  // a real level at price 0 is fillable
+  Order b1(1, Side::Buy, 0, 10, 1);
+  Order b2(2, Side::Buy, 2, 10, 2);
+  book.add_order(b1);
+  book.add_order(b2);
+  EXPECT_EQ(book.price_to_fill(Side::Sell, 20).value(), 0);
+  EXPECT_DOUBLE_EQ(book.vwap_for_quantity(Side::Sell, 20).value(), 1.0);
+
+  // quantities beyond int64 range are unfillable, not wrapped negative
+  uint64_t const huge = std::numeric_limits<uint64_t>::max();
+  EXPECT_FALSE(book.price_to_fill(Side::Sell, huge).has_value());
+
+  book.enable_depth_index(-5, 5);
+  EXPECT_EQ(book.price_to_fill(Side::Sell, 20).value(), 0);
+  EXPECT_DOUBLE_EQ(book.vwap_for_quantity(Side::Sell, 20).value(), 1.0);
+  EXPECT_FALSE(book.price_to_fill(Side::Sell, huge).has_value());
+  EXPECT_FALSE(book.sweep(Side::Sell, huge).filled);
+}
+
+TEST_F(OrderBookUnitTest, DepthIndexReversedBounds) {
+  // the bounds are checked before the trees are sized from them
+  EXPECT_DEBUG_DEATH(
+      {
+        DepthIndex index(110, 100);
+        EXPECT_EQ(index.min_price, 100);
+        EXPECT_EQ(index.max_price, 110);
+        EXPECT_EQ(index.quantity_tree.size(), 12);
+      },
+      "");
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,341 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "Replication.h"
+#include "Xorshift.h"
+
+class ReplicationUnitTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  }
+  void TearDown() override {
+    if (fds[0] >= 0) ::close(fds[0]);
+    if (fds[1] >= 0) ::close(fds[1]);
+  }
+
+  // random mix of adds, modifies and cancels around a common mid price
+  static void drive(ReplicationPrimary& primary, order_id_t first_id,
+                    order_id_t last_id) {
+    Xorshift rng(88172645463325252ULL ^ first_id);
+    for (order_id_t id = first_id; id <= last_id; ++id) {
+      uint64_t const state = rng.next();
+      if (state % 10 < 7) {
+        Side side = (state & 16) ? Side::Buy : Side::Sell;
+        price_t offset = static_cast<price_t>((state >> 8) % 40);
+        price_t price = (side == Side::Buy) ? 1005 - offset : 995 + offset;
+        quantity_t quantity = static_cast<quantity_t>((state >> 20) % 50) + 1;
+        primary.add_order(Order(id, side, price, quantity, id));
+      } else if (state % 10 < 9) {
+        primary.cancel_order((state >> 8) % id);
+      } else {
+        quantity_t quantity = static_cast<quantity_t>((state >> 20) % 50) + 1;
+        primary.modify_order((state >> 8) % id, quantity);
+      }
+    }
+  }
+
+  // applies the same commands as drive with no backup attached
+  static void replay(OrderBook& book, order_id_t first_id,
+                     order_id_t last_id) {
+    int dead_fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, dead_fds), 0);
+    ::close(dead_fds[1]);
+    ReplicationPrimary primary(dead_fds[0], book, first_id - 1);
+    drive(primary, first_id, last_id);
+    primary.flush();
+    EXPECT_FALSE(primary.connected);
+    ::close(dead_fds[0]);
+  }
+
+  static void expect_same_book(const OrderBook& lhs, const OrderBook& rhs) {
+    auto lhs_bids = lhs.get_bids(lhs.bid_depth());
+    auto rhs_bids = rhs.get_bids(rhs.bid_depth());
+    ASSERT_EQ(lhs_bids.size(), rhs_bids.size());
+    for (size_t i = 0; i < lhs_bids.size(); ++i) {
+      EXPECT_EQ(lhs_bids[i].price, rhs_bids[i].price);
+      EXPECT_EQ(lhs_bids[i].quantity, rhs_bids[i].quantity);
+      EXPECT_EQ(lhs_bids[i].order_count, rhs_bids[i].order_count);
+    }
+
+    auto lhs_asks = lhs.get_asks(lhs.ask_depth());
+    auto rhs_asks = rhs.get_asks(rhs.ask_depth());
+    ASSERT_EQ(lhs_asks.size(), rhs_asks.size());
+    for (size_t i = 0; i < lhs_asks.size(); ++i) {
+      EXPECT_EQ(lhs_asks[i].price, rhs_asks[i].price);
+      EXPECT_EQ(lhs_asks[i].quantity, rhs_asks[i].quantity);
+      EXPECT_EQ(lhs_asks[i].order_count, rhs_asks[i].order_count);
+    }
+
+    ASSERT_EQ(lhs.order_pool.size(), rhs.order_pool.size());
+    for (auto const& [id, order] : lhs.order_pool) {
+      auto it = rhs.order_pool.find(id);
+      ASSERT_NE(it, rhs.order_pool.end());
+      EXPECT_EQ(*order, *(it->second));
+    }
+  }
+
+  int fds[2]{-1, -1};
+};
+
+TEST_F(ReplicationUnitTest, BackupMatchesPrimary) {
+  OrderBook primary_book;
+  OrderBook backup_book;
+
+  ReplicationBackup backup(fds[1], backup_book);
+  std::thread backup_thread([&backup]() { backup.run(); });
+
+  ReplicationPrimary primary(fds[0], primary_book);
+  drive(primary, 1, 20000);
+  EXPECT_TRUE(primary.wait_for_acks());
+  EXPECT_EQ(primary.last_acked, 20000);
+  EXPECT_TRUE(primary.unacked.empty());
+
+  ::shutdown(fds[0], SHUT_RDWR);
+  backup_thread.join();
+
+  EXPECT_EQ(backup.last_sequence, 20000);
+  expect_same_book(primary_book, backup_book);
+}
+
+TEST_F(ReplicationUnitTest, FailoverResumesFromLastAck) {
+  OrderBook primary_book;
+  OrderBook backup_book;
+
+  ReplicationBackup backup(fds[1], backup_book);
+  std::thread backup_thread([&backup]() { backup.run(); });
+
+  // the primary dies with a partial batch applied locally but never sent,
+  // as when it crashes before its input queue drains and flush() is called
+  ReplicationPrimary primary(fds[0], primary_book);
+  drive(primary, 1, 10037);
+  EXPECT_FALSE(primary.send_buffer.empty());
+  ::close(fds[0]);
+  fds[0] = -1;
+  backup_thread.join();
+
+  // the backup is at or past everything acked but short of the primary
+  EXPECT_GE(backup.last_sequence, primary.last_acked);
+  EXPECT_LT(backup.last_sequence, primary.sequence);
+  ASSERT_FALSE(primary.unacked.empty());
+  ASSERT_LE(primary.unacked.front().sequence, backup.last_sequence + 1);
+  EXPECT_EQ(primary.unacked.back().sequence, 10037);
+
+  // the backup takes over and replicates to a standby that was caught up
+  // to the backup's sequence before the failover
+  int next_fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, next_fds), 0);
+  OrderBook standby_book;
+  replay(standby_book, 1, backup.last_sequence);
+  ReplicationBackup standby(next_fds[1], standby_book);
+  standby.last_sequence = backup.last_sequence;
+  std::thread standby_thread([&standby]() { standby.run(); });
+
+  ReplicationPrimary new_primary = backup.take_over(next_fds[0]);
+  EXPECT_EQ(new_primary.sequence, backup.last_sequence);
+
+  // order entry resubmits everything the backup had not applied, keeping
+  // the original sequence numbers, then new flow continues
+  for (auto const& command : primary.unacked) {
+    if (command.sequence <= new_primary.sequence) continue;
+    EXPECT_EQ(new_primary.submit(command), command.sequence);
+  }
+  expect_same_book(primary_book, backup_book);
+
+  drive(new_primary, 10038, 15000);
+  EXPECT_TRUE(new_primary.wait_for_acks());
+  EXPECT_EQ(new_primary.last_acked, 15000);
+
+  ::shutdown(next_fds[0], SHUT_RDWR);
+  standby_thread.join();
+  ::close(next_fds[0]);
+  ::close(next_fds[1]);
+
+  // the old primary's book replays the same commands without replication
+  replay(primary_book, 10038, 15000);
+
+  EXPECT_EQ(standby.last_sequence, 15000);
+  expect_same_book(primary_book, backup_book);
+  expect_same_book(backup_book, standby_book);
+}
+
+TEST_F(ReplicationUnitTest, ReconnectResendsUnacked) {
+  OrderBook primary_book;
+  OrderBook backup_book;
+
+  // the backup stops reading partway through and drops the connection
+  ReplicationBackup backup(fds[1], backup_book);
+  std::thread backup_thread([this, &backup]() {
+    for (size_t i = 0; i < 5; ++i) backup.poll();
+    ::shutdown(fds[1], SHUT_RDWR);
+  });
+
+  ReplicationPrimary primary(fds[0], primary_book, 0, 100);
+  drive(primary, 1, 20000);
+  primary.flush();
+  backup_thread.join();
+  EXPECT_FALSE(primary.connected);
+  EXPECT_LT(backup.last_sequence, 20000);
+  EXPECT_GE(backup.last_sequence, primary.last_acked);
+
+  // the same backup comes back on a new connection and catches up
+  int next_fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, next_fds), 0);
+  backup.reconnect(next_fds[1]);
+  std::thread resume_thread([&backup]() { backup.run(); });
+
+  EXPECT_TRUE(primary.resend_unacked(next_fds[0]));
+  EXPECT_TRUE(primary.wait_for_acks());
+  EXPECT_EQ(primary.last_acked, 20000);
+  EXPECT_TRUE(primary.unacked.empty());
+
+  ::shutdown(next_fds[0], SHUT_RDWR);
+  resume_thread.join();
+  ::close(next_fds[0]);
+  ::close(next_fds[1]);
+
+  EXPECT_EQ(backup.last_sequence, 20000);
+  expect_same_book(primary_book, backup_book);
+}
+
+TEST_F(ReplicationUnitTest, WaitForAcksTimesOut) {
+  OrderBook primary_book;
+
+  // nothing reads the other end, so no ack ever arrives
+  ReplicationPrimary primary(fds[0], primary_book, 0, 50);
+  primary.add_order(Order(1, Side::Buy, 100, 10, 1));
+  EXPECT_FALSE(primary.wait_for_acks());
+  EXPECT_FALSE(primary.connected);
+  EXPECT_EQ(primary.unacked.size(), 1);
+
+  // the book keeps running alone and keeps commands for a resend
+  primary.add_order(Order(2, Side::Sell, 101, 10, 2));
+  EXPECT_EQ(primary.unacked.size(), 2);
+  EXPECT_EQ(primary_book.order_pool.size(), 2);
+}
+
+TEST_F(ReplicationUnitTest, JournalIsCapped) {
+  OrderBook primary_book;
+
+  // the backup is gone and the journal fills past its cap
+  ReplicationPrimary primary(fds[0], primary_book);
+  primary.max_unacked = 100;
+  primary.disconnect();
+  drive(primary, 1, 100);
+  EXPECT_EQ(primary.unacked.size(), 100);
+  EXPECT_FALSE(primary.resync_required);
+  drive(primary, 101, 150);
+  EXPECT_TRUE(primary.resync_required);
+  EXPECT_TRUE(primary.unacked.empty());
+
+  // nothing is kept or resent once the journal was dropped
+  int next_fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, next_fds), 0);
+  EXPECT_FALSE(primary.resend_unacked(next_fds[0]));
+  EXPECT_FALSE(primary.connected);
+  drive(primary, 151, 200);
+  EXPECT_TRUE(primary.unacked.empty());
+
+  // a backup seeded with the book as of now is attached with a new journal
+  OrderBook backup_book;
+  replay(backup_book, 1, 100);
+  replay(backup_book, 101, 150);
+  replay(backup_book, 151, 200);
+  ReplicationBackup backup(next_fds[1], backup_book);
+  backup.last_sequence = 200;
+  std::thread backup_thread([&backup]() { backup.run(); });
+
+  primary.max_unacked = ReplicationPrimary::k_default_max_unacked;
+  primary.attach(next_fds[0]);
+  EXPECT_EQ(primary.last_acked, 200);
+  drive(primary, 201, 5000);
+  EXPECT_TRUE(primary.wait_for_acks());
+  EXPECT_EQ(primary.last_acked, 5000);
+
+  ::shutdown(next_fds[0], SHUT_RDWR);
+  backup_thread.join();
+  ::close(next_fds[0]);
+  ::close(next_fds[1]);
+  expect_same_book(primary_book, backup_book);
+}
+
+TEST_F(ReplicationUnitTest, BackupBehindLastAckIsRefused) {
+  // everything up to 100 was acked by a backup that is now gone for good
+  OrderBook primary_book;
+  ReplicationPrimary primary(fds[0], primary_book, 100);
+  primary.disconnect();
+  drive(primary, 101, 110);
+  ASSERT_EQ(primary.unacked.size(), 10);
+
+  // a fresh backup and a stale one are both missing 51..100
+  for (uint64_t const last_sequence : {0, 50}) {
+    int next_fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, next_fds), 0);
+    OrderBook backup_book;
+    ReplicationBackup backup(next_fds[1], backup_book);
+    backup.last_sequence = last_sequence;
+    std::thread backup_thread([&backup]() { backup.run(); });
+
+    EXPECT_TRUE(primary.resend_unacked(next_fds[0]));
+    EXPECT_FALSE(primary.wait_for_acks());
+    backup_thread.join();
+    ::close(next_fds[0]);
+    ::close(next_fds[1]);
+
+    EXPECT_FALSE(primary.connected);
+    EXPECT_EQ(primary.last_acked, 100);
+    EXPECT_EQ(primary.unacked.size(), 10);
+    EXPECT_EQ(backup.last_sequence, last_sequence);
+    EXPECT_TRUE(backup_book.order_pool.empty());
+  }
+
+  // a backup that does hold 100 is still accepted afterwards
+  int next_fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, next_fds), 0);
+  OrderBook backup_book;
+  ReplicationBackup backup(next_fds[1], backup_book);
+  backup.last_sequence = 100;
+  std::thread backup_thread([&backup]() { backup.run(); });
+
+  EXPECT_TRUE(primary.resend_unacked(next_fds[0]));
+  EXPECT_TRUE(primary.wait_for_acks());
+  EXPECT_EQ(primary.last_acked, 110);
+
+  ::shutdown(next_fds[0], SHUT_RDWR);
+  backup_thread.join();
+  ::close(next_fds[0]);
+  ::close(next_fds[1]);
+  expect_same_book(primary_book, backup_book);
+}
+
+TEST_F(ReplicationUnitTest, ResentCommandsAreSkipped) {
+  OrderBook backup_book;
+  ReplicationBackup backup(fds[1], backup_book);
+
+  Command add(CommandType::Add, Order(1, Side::Buy, 100, 10, 1));
+  add.sequence = 1;
+  ASSERT_EQ(::send(fds[0], &add, sizeof(add), 0), (ssize_t)sizeof(add));
+  ASSERT_TRUE(backup.poll());
+
+  // same command again after a reconnect must not double the order
+  ASSERT_EQ(::send(fds[0], &add, sizeof(add), 0), (ssize_t)sizeof(add));
+  ASSERT_TRUE(backup.poll());
+
+  EXPECT_EQ(backup.last_sequence, 1);
+  EXPECT_EQ(backup_book.order_pool.size(), 1);
+  EXPECT_EQ(backup_book.get_top().bid_quantity, 10);
+
+  ack_t acks[2];
+  ASSERT_EQ(::recv(fds[0], acks, sizeof(acks), MSG_WAITALL),
+            (ssize_t)sizeof(acks));
+  EXPECT_EQ(acks[0], 1);
+  EXPECT_EQ(acks[1], 1);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}